@@ -0,0 +1,228 @@
+/**
+ * Benchmarks the fixed size capture checks against the generic check, which
+ * runs the same flood fill with the board size only known at runtime. Also
+ * compares the two on positions with captures on edges, in corners and in
+ * the middle of the board, and exits with status 1 if they ever disagree.
+ *
+ * Build from the repository root with:
+ *   gcc -std=c99 -O2 -pthread -o engine_bench bench/board_engine_bench.c
+ */
+#define main nogo_main
+#include "../go.c"
+#undef main
+
+#define REPEATS 200
+#define PATTERNS 8
+#define PATTERN_SIZE 3
+#define RANDOM_BOARDS 300
+
+
+/**
+ * Small positions placed on the board by check_patterns. Each is placed in
+ * every corner, reflected to fit, and in the middle of the board, with its
+ * tokens as given and swapped.
+ */
+const char* patterns[PATTERNS][PATTERN_SIZE] = {
+    /* A stone captured in the corner */
+    {"OX.", "X..", "..."},
+    /* A stone captured on the edge */
+    {"XOX", ".X.", "..."},
+    /* A string along the edge with its last liberty filled */
+    {"OOX", "XX.", "..."},
+    /* A string along the edge with one liberty left */
+    {"OO.", "XX.", "..."},
+    /* An L shaped string captured in the corner */
+    {"OOX", "OX.", "X.."},
+    /* Stones of both tokens captured at once */
+    {"OXO", "XO.", "..."},
+    /* A stone captured away from the edges */
+    {".X.", "XOX", ".X."},
+    /* A string surrounded except for one point */
+    {"XXX", "OOX", "X.X"}
+};
+
+
+/**
+ * Returns the current monotonic time in seconds.
+ */
+double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+
+/**
+ * Allocates an empty square game and chooses its capture check.
+ *   - size, the side of the board
+ *   - players, where the players are allocated
+ */
+struct GameProperties* new_game(int size, struct Player*** players) {
+    char sizeArgument[8];
+    sprintf(sizeArgument, "%d", size);
+    char* argv[] = {"nogo", "c", "c", sizeArgument, sizeArgument};
+
+    struct GameProperties* game = malloc(sizeof(struct GameProperties));
+    game->cache = NULL;
+    game->autosave = NULL;
+    *players = malloc(sizeof(struct Player*) * 2);
+    for (int i = 0; i < 2; ++i) {
+        (*players)[i] = malloc(sizeof(struct Player));
+    }
+    initialise_grid(game, argv);
+    initialise_player(game, *players, argv);
+    select_board_engine(game);
+    return game;
+}
+
+
+/**
+ * Sets every point on the board to '.'.
+ *   - game, a struct of the game state
+ */
+void clear_grid(struct GameProperties* game) {
+    for (int i = 0; i < game->height; ++i) {
+        memset(game->gameGrid[i], '.', game->width);
+    }
+}
+
+
+/**
+ * Compares the generic and fixed size checks for both tokens on the current
+ * position. Returns false if they disagree.
+ *   - game, a struct of the game state
+ *   - captures, counts of positions where each of O and X was captured
+ */
+bool compare_engines(struct GameProperties* game, int* captures) {
+    bool agree = true;
+    for (int i = 0; i < 2; i++) {
+        bool generic = any_captured_generic(game, "OX"[i]);
+        if (generic != game->anyCaptured(game, "OX"[i])) {
+            agree = false;
+        }
+        captures[i] += generic;
+    }
+    return agree;
+}
+
+
+/**
+ * Compares the checks on every pattern in every placement, and on random
+ * boards of increasing density. Returns false if they ever disagree.
+ *   - game, a struct of the game state
+ *   - size, the side of the board
+ */
+bool check_patterns(struct GameProperties* game, int size) {
+    int captures[2] = {0, 0};
+    int positions = 0;
+    bool agree = true;
+
+    for (int p = 0; p < PATTERNS; ++p) {
+        for (int placement = 0; placement < 5; ++placement) {
+            for (int swap = 0; swap < 2; ++swap) {
+                clear_grid(game);
+                for (int i = 0; i < PATTERN_SIZE; ++i) {
+                    for (int j = 0; j < PATTERN_SIZE; j++) {
+                        int row = (placement & 1) ? size - 1 - i : i;
+                        int col = (placement & 2) ? size - 1 - j : j;
+                        if (placement == 4) {
+                            row = size / 2 - 1 + i;
+                            col = size / 2 - 1 + j;
+                        }
+                        char token = patterns[p][i][j];
+                        if (swap == 1 && token != '.') {
+                            token = (token == 'O') ? 'X' : 'O';
+                        }
+                        game->gameGrid[row][col] = token;
+                    }
+                }
+                agree = compare_engines(game, captures) && agree;
+                positions++;
+            }
+        }
+    }
+
+    srand(size);
+    for (int b = 0; b < RANDOM_BOARDS; ++b) {
+        int density = b * 100 / RANDOM_BOARDS;
+        for (int i = 0; i < size; ++i) {
+            for (int j = 0; j < size; j++) {
+                int roll = rand() % 100;
+                game->gameGrid[i][j] = (roll < density)
+                        ? ((roll & 1) ? 'X' : 'O') : '.';
+            }
+        }
+        agree = compare_engines(game, captures) && agree;
+        positions++;
+    }
+
+    printf("%2dx%-2d %4d checked positions  O captured in %d  X captured in "
+            "%d%s\n", size, size, positions, captures[0], captures[1],
+            agree ? "" : "  MISMATCH");
+    return agree;
+}
+
+
+/**
+ * Plays a computer versus computer game on a square board, timing both
+ * capture checks on every position. Returns false if they disagree.
+ *   - game, a struct of the game state
+ *   - players, an array of players' properties
+ *   - size, the side of the board
+ */
+bool bench_game(struct GameProperties* game, struct Player** players,
+        int size) {
+    double genericTime = 0, fixedTime = 0;
+    int positions = 0;
+    bool agree = true;
+
+    clear_grid(game);
+    for (int active = 0; ; active = 1 - active) {
+        bool generic[2], fixed[2];
+        double start = now();
+        for (int r = 0; r < REPEATS; ++r) {
+            for (int i = 0; i < 2; i++) {
+                generic[i] = any_captured_generic(game, players[i]->token);
+            }
+        }
+        double middle = now();
+        for (int r = 0; r < REPEATS; ++r) {
+            for (int i = 0; i < 2; i++) {
+                fixed[i] = game->anyCaptured(game, players[i]->token);
+            }
+        }
+        fixedTime += now() - middle;
+        genericTime += middle - start;
+        positions++;
+
+        if (generic[0] != fixed[0] || generic[1] != fixed[1]) {
+            agree = false;
+        }
+        if (generic[0] || generic[1]) {
+            break;
+        }
+        int x, y;
+        get_computer_move(game, players, active, &x, &y);
+        game->gameGrid[x][y] = players[active]->token;
+    }
+
+    printf("%2dx%-2d %4d game positions    generic %8.3f ms  fixed %8.3f ms"
+            "  speedup %4.2fx%s\n", size, size, positions, genericTime * 1e3,
+            fixedTime * 1e3, genericTime / fixedTime,
+            agree ? "" : "  MISMATCH");
+    return agree;
+}
+
+
+int main(void) {
+    bool agree = true;
+    int sizes[] = {9, 13};
+    for (int i = 0; i < 2; ++i) {
+        struct Player** players;
+        struct GameProperties* game = new_game(sizes[i], &players);
+        agree = check_patterns(game, sizes[i]) && agree;
+        agree = bench_game(game, players, sizes[i]) && agree;
+        free_allocated_memory(game, players, ALL);
+    }
+    return agree ? 0 : 1;
+}
@@ -1,7 +1,17 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define HUMAN 1
 #define COMPUTER 2
@@ -9,17 +19,85 @@
 #define ALL 1
 #define PRELIMINARY 2
 
+#define CACHE_PATH_VARIABLE "NOGO_CACHE"
+#define CACHE_MAGIC 0x4E4F474F43414348ULL
+#define CACHE_VERSION 1
+#define CACHE_BUCKETS 65536
+#define CACHE_WAYS 2
+
+#define AUTOSAVE_PATH_VARIABLE "NOGO_AUTOSAVE"
+#define AUTOSAVE_MOVES_VARIABLE "NOGO_AUTOSAVE_MOVES"
+#define AUTOSAVE_SECONDS_VARIABLE "NOGO_AUTOSAVE_SECONDS"
+
+
+/**
+ * A single slot of the position cache. The check word holds the position
+ * key XORed with a hash of the remaining fields, so a slot torn by two
+ * processes writing at once simply fails verification:
+ *   - the verification word
+ *   - the row and column of the move chosen from the position
+ *   - the move algorithm counters (M, r, c, next row, next column) left
+ *   behind once the move was chosen
+ *   - the number of occupied points skipped to find the move, used as the
+ *   evaluation of how costly the position was to analyse
+ */
+struct CacheEntry {
+    uint64_t check;
+    int32_t x;
+    int32_t y;
+    int32_t m;
+    int32_t r;
+    int32_t c;
+    int32_t nextX;
+    int32_t nextY;
+    int32_t probes;
+};
+
+
+/**
+ * The header at the start of the position cache file:
+ *   - a magic number identifying the file
+ *   - the layout version
+ *   - the number of buckets, each holding CACHE_WAYS entries
+ */
+struct CacheHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t buckets;
+};
+
+
+/**
+ * A memory-mapped position cache shared between processes:
+ *   - the mapped file header
+ *   - the mapped array of entries following the header
+ *   - the size of the mapping in bytes
+ */
+struct PositionCache {
+    struct CacheHeader* header;
+    struct CacheEntry* entries;
+    size_t size;
+};
+
 
 /**
  * A struct representing the state of the board and its properties:
  *   - the height of the board
  *   - the width of the board
  *   - a 2D character array representing the state of the board
+ *   - a hash of the tokens on the board, updated as moves are made
+ *   - the position cache used by computer players, or NULL if disabled
+ *   - the autosave settings and writer, or NULL if disabled
+ *   - the check for captured strings chosen for the board size
  */
 struct GameProperties {
     int height;
     int width;
     char** gameGrid;
+    uint64_t positionHash;
+    struct PositionCache* cache;
+    struct Autosave* autosave;
+    bool (*anyCaptured)(struct GameProperties* game, char token);
 };
 
 
@@ -65,6 +143,283 @@ struct Player {
 };
 
 
+/**
+ * A copy of everything written to a save file, taken so that it can be
+ * written while the game carries on:
+ *   - the height of the board
+ *   - the width of the board
+ *   - the player to move next: 0 if it is player O or 1 if it is player X
+ *   - copies of both players' move algorithm state
+ *   - the board tokens, row by row
+ */
+struct SaveSnapshot {
+    int height;
+    int width;
+    int active;
+    struct MoveAlgorithm variables[2];
+    char* grid;
+};
+
+
+/**
+ * The autosave settings and the state shared with the background thread
+ * that writes autosaves:
+ *   - the filepath of the autosave file
+ *   - the filepath written to before being renamed over the autosave file
+ *   - the number of moves between autosaves, or 0 if not saving by moves
+ *   - the number of seconds between autosaves, or 0 if not saving by time
+ *   - the number of moves made since the last autosave
+ *   - the time of the last autosave
+ *   - the background writer thread
+ *   - a lock protecting the pending snapshot and the stopping flag
+ *   - a condition signalled when a snapshot becomes pending or the writer
+ *   is asked to stop
+ *   - the snapshot waiting to be written, or NULL if there is none
+ *   - whether the writer should exit once nothing is pending
+ */
+struct Autosave {
+    char* filepath;
+    char* tempFilepath;
+    int moves;
+    int seconds;
+    int movesSinceSave;
+    time_t lastSave;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    struct SaveSnapshot* pending;
+    bool stopping;
+};
+
+
+/**
+ * Mixes a 64 bit value so that every input bit affects every output bit.
+ *   - value, the value to mix
+ */
+uint64_t mix_hash(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+
+/**
+ * Returns the contribution of a token at a point to the position hash.
+ * Empty points contribute nothing, so the hash can be updated with a single
+ * XOR whenever a token is placed.
+ *   - game, a struct of the game state
+ *   - row, the row of the point
+ *   - col, the column of the point
+ *   - token, the token at the point
+ */
+uint64_t point_hash(struct GameProperties* game, int row, int col, 
+        char token) {
+    if (token == '.') {
+        return 0;
+    }
+    uint64_t point = (uint64_t)row * game->width + col;
+    return mix_hash((point << 1) | (token == 'X'));
+}
+
+
+/**
+ * Calculates the position hash of the whole game grid from scratch.
+ *   - game, a struct of the game state
+ */
+void initialise_position_hash(struct GameProperties* game) {
+    game->positionHash = mix_hash(((uint64_t)game->height << 32) 
+            | (uint64_t)game->width);
+    for (int i = 0; i < game->height; ++i) {
+        for (int j = 0; j < game->width; j++) {
+            game->positionHash ^= point_hash(game, i, j, 
+                    game->gameGrid[i][j]);
+        }
+    }
+}
+
+
+/**
+ * Hashes the fields of a cache entry other than its verification word.
+ *   - entry, the cache entry
+ */
+uint64_t cache_entry_hash(struct CacheEntry* entry) {
+    uint64_t hash = mix_hash(((uint64_t)(uint32_t)entry->x << 32) 
+            | (uint32_t)entry->y);
+    hash = mix_hash(hash ^ (((uint64_t)(uint32_t)entry->m << 32) 
+            | (uint32_t)entry->r));
+    hash = mix_hash(hash ^ (((uint64_t)(uint32_t)entry->c << 32) 
+            | (uint32_t)entry->nextX));
+    return mix_hash(hash ^ (((uint64_t)(uint32_t)entry->nextY << 32) 
+            | (uint32_t)entry->probes));
+}
+
+
+/**
+ * Creates a position cache file with its header already written. The file
+ * is built under a temporary name and linked into place, so other
+ * processes never see it before it is complete. Returns a descriptor for
+ * the cache file, which another process may have created first, or -1 on
+ * failure.
+ *   - filepath, the filepath of the cache file
+ *   - size, the size of the cache file in bytes
+ */
+int create_position_cache(const char* filepath, size_t size) {
+    char* tempFilepath = malloc(strlen(filepath) + 32);
+    sprintf(tempFilepath, "%s.%ld.tmp", filepath, (long)getpid());
+
+    int fd = open(tempFilepath, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) {
+        free(tempFilepath);
+        return -1;
+    }
+    struct CacheHeader header = {CACHE_MAGIC, CACHE_VERSION, CACHE_BUCKETS};
+    bool built = (ftruncate(fd, (off_t)size) == 0) 
+            && (pwrite(fd, &header, sizeof(header), 0) 
+            == (ssize_t)sizeof(header));
+
+    if (built == false) {
+        close(fd);
+        fd = -1;
+    } else if (link(tempFilepath, filepath) == -1) {
+        close(fd);
+        fd = (errno == EEXIST) ? open(filepath, O_RDWR) : -1;
+    }
+    unlink(tempFilepath);
+    free(tempFilepath);
+    return fd;
+}
+
+
+/**
+ * Opens the position cache file, creating it if it does not exist.
+ * Returns NULL if the cache cannot be used, in which case computer players
+ * simply calculate every move.
+ *   - filepath, the filepath of the cache file
+ */
+struct PositionCache* open_position_cache(const char* filepath) {
+    size_t size = sizeof(struct CacheHeader) 
+            + sizeof(struct CacheEntry) * CACHE_BUCKETS * CACHE_WAYS;
+
+    int fd = open(filepath, O_RDWR);
+    if (fd == -1 && errno == ENOENT) {
+        fd = create_position_cache(filepath, size);
+    }
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat fileStatus;
+    if (fstat(fd, &fileStatus) == -1 
+            || (size_t)fileStatus.st_size != size) {
+        close(fd);
+        return NULL;
+    }
+
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, 
+            fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+
+    struct CacheHeader* header = mapping;
+    if (header->magic != CACHE_MAGIC || header->version != CACHE_VERSION 
+            || header->buckets != CACHE_BUCKETS) {
+        munmap(mapping, size);
+        return NULL;
+    }
+
+    struct PositionCache* cache = malloc(sizeof(struct PositionCache));
+    cache->header = header;
+    cache->entries = (struct CacheEntry*)(header + 1);
+    cache->size = size;
+    return cache;
+}
+
+
+/**
+ * Unmaps the position cache and frees its memory. Does nothing if the cache
+ * is disabled.
+ *   - cache, the position cache
+ */
+void close_position_cache(struct PositionCache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+    munmap(cache->header, cache->size);
+    free(cache);
+}
+
+
+/**
+ * Looks up a position in the cache. Returns true and copies the entry into
+ * result if the position has been analysed before, otherwise false.
+ *   - cache, the position cache
+ *   - key, the key of the position
+ *   - result, where a matching entry is copied
+ */
+bool cache_probe(struct PositionCache* cache, uint64_t key, 
+        struct CacheEntry* result) {
+    struct CacheEntry* bucket = cache->entries 
+            + (key % CACHE_BUCKETS) * CACHE_WAYS;
+
+    for (int i = 0; i < CACHE_WAYS; ++i) {
+        /* Copy first, as another process may be writing the slot */
+        *result = bucket[i];
+        if ((result->check ^ cache_entry_hash(result)) == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Stores an analysed position in the cache. The first slot of a bucket
+ * keeps whichever position was most costly to analyse, and the second slot
+ * is always replaced.
+ *   - cache, the position cache
+ *   - key, the key of the position
+ *   - entry, the entry to store, with its verification word unset
+ */
+void cache_store(struct PositionCache* cache, uint64_t key, 
+        struct CacheEntry* entry) {
+    struct CacheEntry* bucket = cache->entries 
+            + (key % CACHE_BUCKETS) * CACHE_WAYS;
+
+    entry->check = key ^ cache_entry_hash(entry);
+    if (entry->probes >= bucket[0].probes 
+            || (bucket[0].check ^ cache_entry_hash(&bucket[0])) == key) {
+        bucket[0] = *entry;
+    } else {
+        bucket[CACHE_WAYS - 1] = *entry;
+    }
+}
+
+
+/**
+ * Stops the background writer once it has written any autosave handed to
+ * it, so that exiting does not lose the latest snapshot, and frees the
+ * autosave state. Does nothing if autosaving is disabled.
+ *   - autosave, the autosave settings
+ */
+void stop_autosave(struct Autosave* autosave) {
+    if (autosave == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&autosave->lock);
+    autosave->stopping = true;
+    pthread_cond_signal(&autosave->ready);
+    pthread_mutex_unlock(&autosave->lock);
+    pthread_join(autosave->thread, NULL);
+
+    pthread_mutex_destroy(&autosave->lock);
+    pthread_cond_destroy(&autosave->ready);
+    free(autosave->tempFilepath);
+    free(autosave);
+}
+
+
 /**
  * Frees the memory allocated previously with malloc.
  *   - game, a struct of the game state
@@ -77,6 +432,8 @@ void free_allocated_memory(struct GameProperties* game,
         struct Player** players, int allocated) {
 
     if (allocated == ALL) {
+        stop_autosave(game->autosave);
+        game->autosave = NULL;
         for (int i = 0; i < 2; i++) {
             free(players[i]->variables);
         }
@@ -88,6 +445,7 @@ void free_allocated_memory(struct GameProperties* game,
             free(game->gameGrid[i]);
         }
         free(game->gameGrid);
+        close_position_cache(game->cache);
         free(game);
 
     } else if (allocated == PRELIMINARY) {
@@ -170,86 +528,152 @@ void display_grid(struct GameProperties* game) {
 
 
 /**
- * When given a point, this function will determine whether the string it
- * belongs to has any '.' adjacent to it.
+ * Copies the game grid into a board with a one point border of '#', so
+ * that the four neighbours of every point on the grid can be read without
+ * bounds checks.
  *  - game, a struct of the game state
- *  - anyLiberties, a boolean where the result of this function is stored
- *  - consideredPoints, the points in the string that have been checked
- *  so far for adjacent '.'
- *  - row, the row of the original point of interest
- *  - col, the column of the original point of interest
- *  (Note: uses the token of (row, col) to determine the string's token)
+ *  - board, the bordered board, (height + 2) * (width + 2) points
+ *  - height, the height of the grid
+ *  - width, the width of the grid
  */
-void adjacent_space_check(struct GameProperties* game, bool* anyLiberties, 
-        char** consideredPoints, int row, int col) {
+static inline void copy_bordered_board(struct GameProperties* game, 
+        char* board, int height, int width) {
+    int side = width + 2;
 
-    if (*anyLiberties == true) {
-        return;
-    }
-    /* Add point to array of considered ('Y') points */
-    consideredPoints[row][col] = 'Y'; 
-    
-    /* Check if an adjacent point is free */
-    for (int i = -1; i < 2; ++i) {
-        for (int j = -1; j < 2; ++j) {
-            if (*anyLiberties == true) {
-                return;
-            }
-            /* This combination corresponds to adjacent points*/            
-            if (((i - j) == 1) || ((j - i) == 1)) {  
-                if ((i + row) < 0 || (j + col) < 0) {
-                    continue;
-                } else if ((i + row) > (game->height - 1) 
-                        || (j + col) > (game->width - 1)) {
-                    continue;
-                } else if (game->gameGrid[i + row][j + col] == '.') {
-                    *anyLiberties = true;
-                    return;
-
-                /* Repeat search for any adjacent members of the string */
-                } else if (game->gameGrid[i + row][j + col] == 
-                        game->gameGrid[row][col]) { 
-                    if (consideredPoints[i + row][j + col] == 'N') { 
-                        //'N' for no, point has not been checked
-                        adjacent_space_check(game, anyLiberties, 
-                                consideredPoints, (i + row), (j + col));
-                    }
-                }
-            }
-        }  
+    memset(board, '#', (size_t)(height + 2) * side);
+    for (int i = 0; i < height; ++i) {
+        memcpy(board + (i + 1) * side + 1, game->gameGrid[i], width);
     }
 }
 
 
 /**
- * Checks the string that the point (row, col) belongs to for any liberties.
- * Returns true if at least one liberty exists, otherwise false.
- *  - game, a struct of the game state
- *  - row, the row of the point
- *  - col, the column of the point
+ * Visits one neighbour of a point during a capture check, noting a liberty
+ * or queueing an unvisited stone of the same string.
+ *  - board, the bordered board made by copy_bordered_board
+ *  - considered, the points already queued
+ *  - stack, the points queued but not yet visited
+ *  - top, the number of points on the stack
+ *  - liberty, set to true if the neighbour is a liberty
+ *  - point, the neighbour
+ *  - token, the token of the string being filled
  */
-bool any_liberties(struct GameProperties* game, int row, int col) {
-    bool anyLiberties = false;
-    char** consideredPoints = malloc(sizeof(char*) * game->height);
-    for (int i = 0; i < game->height; ++i) {
-        consideredPoints[i] = malloc(sizeof(char) * game->width);
+static inline void visit_neighbour(const char* board, bool* considered, 
+        int* stack, int* top, bool* liberty, int point, char token) {
+    if (board[point] == '.') {
+        *liberty = true;
+    } else if (board[point] == token && considered[point] == false) {
+        considered[point] = true;
+        stack[(*top)++] = point;
     }
+}
 
-    for (int i = 0; i < game->height; ++i) {
-        for (int j = 0; j < game->width; j++) {
-            consideredPoints[i][j] = 'N';
-            // initialising each point as not ('N') having been considered
+/**
+ * Flood fills each string of the given token on a bordered board once,
+ * checking it for liberties. Returns true if any string has no liberties,
+ * otherwise false. Inlined into each capture check, so that the fixed size
+ * engines get constant dimensions and neighbour offsets.
+ *  - board, the bordered board made by copy_bordered_board
+ *  - considered, (height + 2) * (width + 2) points set to false
+ *  - stack, room for height * width points
+ *  - height, the height of the grid
+ *  - width, the width of the grid
+ *  - token, the token of the strings to check
+ */
+static inline bool flood_any_captured(char* board, bool* considered, 
+        int* stack, int height, int width, char token) {
+    int side = width + 2;
+
+    for (int start = side + 1; start < (height + 1) * side; ++start) {
+        if (board[start] != token || considered[start] == true) {
+            continue;
+        }
+        bool liberty = false;
+        int top = 0;
+        considered[start] = true;
+        stack[top++] = start;
+        while (top > 0) {
+            int point = stack[--top];
+            visit_neighbour(board, considered, stack, &top, &liberty, 
+                    point - side, token);
+            visit_neighbour(board, considered, stack, &top, &liberty, 
+                    point - 1, token);
+            visit_neighbour(board, considered, stack, &top, &liberty, 
+                    point + 1, token);
+            visit_neighbour(board, considered, stack, &top, &liberty, 
+                    point + side, token);
+        }
+        if (liberty == false) {
+            return true;
         }
     }
-    adjacent_space_check(game, &anyLiberties, consideredPoints, row, col);
+    return false;
+}
 
-    for (int i = 0; i < game->height; ++i) {
-        free(consideredPoints[i]);
-    }
-    free(consideredPoints);
 
-    return anyLiberties; 
-} 
+/**
+ * Checks every string of the given token for liberties on a board of any
+ * size. Returns true if any string has no liberties, otherwise false.
+ *  - game, a struct of the game state
+ *  - token, the token of the strings to check
+ */
+bool any_captured_generic(struct GameProperties* game, char token) {
+    size_t points = (size_t)(game->height + 2) * (game->width + 2);
+    char* board = malloc(sizeof(char) * points);
+    bool* considered = calloc(points, sizeof(bool));
+    int* stack = malloc(sizeof(int) * game->height * game->width);
+
+    copy_bordered_board(game, board, game->height, game->width);
+    bool captured = flood_any_captured(board, considered, stack, 
+            game->height, game->width, token);
+
+    free(board);
+    free(considered);
+    free(stack);
+    return captured;
+}
+
+
+/**
+ * Defines any_captured_N, the capture check for square boards of side N.
+ * It runs the same flood fill as any_captured_generic, but with N known at
+ * compile time and the buffers in fixed size arrays.
+ *  - game, a struct of the game state
+ *  - token, the token of the strings to check
+ */
+#define DEFINE_FIXED_SIZE_ENGINE(N) \
+bool any_captured_##N(struct GameProperties* game, char token) { \
+    char board[(N + 2) * (N + 2)]; \
+    bool considered[(N + 2) * (N + 2)] = {false}; \
+    int stack[N * N]; \
+    \
+    copy_bordered_board(game, board, N, N); \
+    return flood_any_captured(board, considered, stack, N, N, token); \
+}
+
+DEFINE_FIXED_SIZE_ENGINE(9)
+DEFINE_FIXED_SIZE_ENGINE(13)
+
+
+/**
+ * Chooses the capture check for the board size, using a fixed size engine
+ * for standard square boards and the generic check otherwise.
+ *   - game, a struct of the game state
+ */
+void select_board_engine(struct GameProperties* game) {
+    game->anyCaptured = any_captured_generic;
+    if (game->height != game->width) {
+        return;
+    }
+    switch(game->width) {
+        case 9:
+            game->anyCaptured = any_captured_9;
+            break;
+        case 13:
+            game->anyCaptured = any_captured_13;
+            break;
+    }
+}
 
 
 /**
@@ -261,15 +685,11 @@ bool any_liberties(struct GameProperties* game, int row, int col) {
  */
 void check_game_over(struct GameProperties* game, struct Player** players, 
         int inactive) {
-    for (int i = 0; i < game->height; ++i) {
-        for (int j = 0; j < game->width; j++) {
-            if (game->gameGrid[i][j] == players[inactive]->token) {
-                if (any_liberties(game, i, j) == false) {
-                    printf("Player %c wins\n", players[1 - inactive]->token);
-                    exit(0);
-                }
-            }
-        }
+    if (game->anyCaptured(game, players[inactive]->token) == true) {
+        printf("Player %c wins\n", players[1 - inactive]->token);
+        stop_autosave(game->autosave);
+        game->autosave = NULL;
+        exit(0);
     }
 }
 
@@ -290,6 +710,64 @@ bool valid_move(struct GameProperties* game, int row, int col) {
 }
 
 
+/**
+ * Copies the game state needed for a save file.
+ *   - game, a struct of the game state
+ *   - players, an array of players' properties
+ *   - active, the active player: 0 if it is player O or 1 if it is 
+ *   player X
+ */
+struct SaveSnapshot* take_snapshot(struct GameProperties* game, 
+        struct Player** players, int active) {
+    struct SaveSnapshot* snapshot = malloc(sizeof(struct SaveSnapshot));
+    snapshot->height = game->height;
+    snapshot->width = game->width;
+    snapshot->active = active;
+    for (int i = 0; i < 2; i++) {
+        snapshot->variables[i] = *players[i]->variables;
+    }
+
+    snapshot->grid = malloc(sizeof(char) * game->height * game->width);
+    for (int i = 0; i < game->height; ++i) {
+        memcpy(snapshot->grid + i * game->width, game->gameGrid[i], 
+                game->width);
+    }
+    return snapshot;
+}
+
+
+/**
+ * Frees a snapshot taken with take_snapshot.
+ *   - snapshot, the snapshot
+ */
+void free_snapshot(struct SaveSnapshot* snapshot) {
+    free(snapshot->grid);
+    free(snapshot);
+}
+
+
+/**
+ * Writes a snapshot in the save file format. Returns true if every write
+ * succeeded, otherwise false.
+ *   - file, the file being written
+ *   - snapshot, the snapshot
+ */
+bool write_snapshot(FILE* file, struct SaveSnapshot* snapshot) {
+    fprintf(file, "%d %d %d %d %d %d %d %d %d\n", snapshot->height, 
+            snapshot->width, snapshot->active, 
+            snapshot->variables[0].nextX, snapshot->variables[0].nextY, 
+            snapshot->variables[0].m, snapshot->variables[1].nextX, 
+            snapshot->variables[1].nextY, snapshot->variables[1].m);
+
+    for (int i = 0; i < snapshot->height; ++i) {   
+        fwrite(snapshot->grid + i * snapshot->width, sizeof(char), 
+                snapshot->width, file);
+        fprintf(file, "\n");
+    }
+    return (fflush(file) == 0) && (ferror(file) == 0);
+}
+
+
 /** 
  * Saves the game state.
  *   - game, a struct of the game state
@@ -319,25 +797,150 @@ void save(struct GameProperties* game, struct Player** players,
     FILE* file = fopen(filepathCorrected, "w");
     if (file == NULL) {
         fprintf(stderr, "Unable to save game\n");
+        return;
     }
 
-    fprintf(file, "%d %d %d %d %d %d %d %d %d\n", game->height, game->width, 
-            active, players[0]->variables->nextX, 
-            players[0]->variables->nextY, players[0]->variables->m, 
-            players[1]->variables->nextX, players[1]->variables->nextY, 
-            players[1]->variables->m);
-
-    for (int i = 0; i < game->height; ++i) {   
-        for (int j = 0; j < game->width; j++) {
-            fprintf(file, "%c", game->gameGrid[i][j]);       
-        }      
-        fprintf(file, "\n");
+    struct SaveSnapshot* snapshot = take_snapshot(game, players, active);
+    if (write_snapshot(file, snapshot) == false) {
+        fprintf(stderr, "Unable to save game\n");
     }
-    fflush(file);       
+    free_snapshot(snapshot);
     fclose(file);
 }
 
 
+/**
+ * Writes a snapshot to the autosave file by writing a temporary file and
+ * renaming it into place, so a crash never leaves a partial autosave.
+ *   - autosave, the autosave settings
+ *   - snapshot, the snapshot
+ */
+void write_autosave(struct Autosave* autosave, 
+        struct SaveSnapshot* snapshot) {
+    FILE* file = fopen(autosave->tempFilepath, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Unable to autosave game\n");
+        return;
+    }
+    bool written = write_snapshot(file, snapshot) 
+            && (fsync(fileno(file)) == 0);
+    if ((fclose(file) != 0) || (written == false)
+            || (rename(autosave->tempFilepath, autosave->filepath) != 0)) {
+        fprintf(stderr, "Unable to autosave game\n");
+        remove(autosave->tempFilepath);
+    }
+}
+
+
+/**
+ * Runs on the background thread, writing each snapshot handed over by the
+ * game thread until asked to stop. Snapshots handed over while a write is
+ * in progress replace one another, so only the latest is written.
+ *   - argument, the autosave settings
+ */
+void* autosave_writer(void* argument) {
+    struct Autosave* autosave = argument;
+
+    while (true) {
+        pthread_mutex_lock(&autosave->lock);
+        while (autosave->pending == NULL && autosave->stopping == false) {
+            pthread_cond_wait(&autosave->ready, &autosave->lock);
+        }
+        struct SaveSnapshot* snapshot = autosave->pending;
+        autosave->pending = NULL;
+        pthread_mutex_unlock(&autosave->lock);
+
+        if (snapshot == NULL) {
+            return NULL;
+        }
+        write_autosave(autosave, snapshot);
+        free_snapshot(snapshot);
+    }
+}
+
+
+/**
+ * Reads the autosave settings from the environment and starts the
+ * background writer. Returns NULL if autosaving is disabled or the writer
+ * cannot be started. Saves after every move if no interval is given.
+ */
+struct Autosave* start_autosave(void) {
+    char* filepath = getenv(AUTOSAVE_PATH_VARIABLE);
+    if (filepath == NULL || filepath[0] == '\0') {
+        return NULL;
+    }
+
+    struct Autosave* autosave = malloc(sizeof(struct Autosave));
+    autosave->filepath = filepath;
+    autosave->tempFilepath = malloc(strlen(filepath) + strlen(".tmp") + 1);
+    sprintf(autosave->tempFilepath, "%s.tmp", filepath);
+    autosave->moves = 0;
+    autosave->seconds = 0;
+    if (getenv(AUTOSAVE_MOVES_VARIABLE) != NULL) {
+        autosave->moves = atoi(getenv(AUTOSAVE_MOVES_VARIABLE));
+    }
+    if (getenv(AUTOSAVE_SECONDS_VARIABLE) != NULL) {
+        autosave->seconds = atoi(getenv(AUTOSAVE_SECONDS_VARIABLE));
+    }
+    if (autosave->moves <= 0 && autosave->seconds <= 0) {
+        autosave->moves = 1;
+    }
+    autosave->movesSinceSave = 0;
+    autosave->lastSave = time(NULL);
+    autosave->pending = NULL;
+    autosave->stopping = false;
+    pthread_mutex_init(&autosave->lock, NULL);
+    pthread_cond_init(&autosave->ready, NULL);
+
+    if (pthread_create(&autosave->thread, NULL, autosave_writer, 
+            autosave) != 0) {
+        fprintf(stderr, "Unable to start autosave\n");
+        pthread_mutex_destroy(&autosave->lock);
+        pthread_cond_destroy(&autosave->ready);
+        free(autosave->tempFilepath);
+        free(autosave);
+        return NULL;
+    }
+    return autosave;
+}
+
+
+/**
+ * Counts a move towards the next autosave and, once a move or time interval
+ * has passed, hands a snapshot of the game to the background writer.
+ *   - game, a struct of the game state
+ *   - players, an array of players' properties
+ *   - active, the player to move next: 0 if it is player O or 1 if it is 
+ *   player X
+ */
+void autosave_move(struct GameProperties* game, struct Player** players, 
+        int active) {
+    struct Autosave* autosave = game->autosave;
+    if (autosave == NULL) {
+        return;
+    }
+    autosave->movesSinceSave++;
+    bool movesPassed = (autosave->moves > 0) 
+            && (autosave->movesSinceSave >= autosave->moves);
+    bool timePassed = (autosave->seconds > 0) 
+            && (time(NULL) - autosave->lastSave >= autosave->seconds);
+    if (movesPassed == false && timePassed == false) {
+        return;
+    }
+    autosave->movesSinceSave = 0;
+    autosave->lastSave = time(NULL);
+
+    struct SaveSnapshot* snapshot = take_snapshot(game, players, active);
+    pthread_mutex_lock(&autosave->lock);
+    if (autosave->pending != NULL) {
+        free_snapshot(autosave->pending);
+    }
+    autosave->pending = snapshot;
+    pthread_cond_signal(&autosave->ready);
+    pthread_mutex_unlock(&autosave->lock);
+}
+
+
 /**
  * Increments the active computer players' next move to be performed.
  *   - game, a struct of the game state
@@ -426,6 +1029,103 @@ void get_player_move(struct GameProperties* game, struct Player** players,
 }
 
 
+/**
+ * Returns the key of the position seen by the active computer player,
+ * combining the position hash with the player's move algorithm state.
+ *   - game, a struct of the game state
+ *   - players, an array of players' properties
+ *   - active, the active player: 0 if it is player O or 1 if it is 
+ *   player X
+ */
+uint64_t position_key(struct GameProperties* game, struct Player** players,
+        int active) {
+    struct MoveAlgorithm* variables = players[active]->variables;
+
+    uint64_t key = mix_hash(game->positionHash ^ (uint64_t)active);
+    key = mix_hash(key ^ (((uint64_t)(uint32_t)variables->f << 32) 
+            | (uint32_t)variables->b));
+    key = mix_hash(key ^ (((uint64_t)(uint32_t)variables->m << 32) 
+            | (uint32_t)variables->r));
+    key = mix_hash(key ^ (((uint64_t)(uint32_t)variables->c << 32) 
+            | (uint32_t)variables->nextX));
+    return mix_hash(key ^ (uint64_t)(uint32_t)variables->nextY);
+}
+
+
+/**
+ * Checks that a cache entry describes a move that can be made in the
+ * current game, as the cache file may be corrupt or written by another
+ * build. Returns true if the entry can be used, otherwise false.
+ *   - game, a struct of the game state
+ *   - variables, the active computer player's move algorithm state
+ *   - entry, the cache entry
+ */
+bool cache_entry_usable(struct GameProperties* game, 
+        struct MoveAlgorithm* variables, struct CacheEntry* entry) {
+    if (valid_move(game, entry->x, entry->y) == false) {
+        return false;
+    } else if (entry->nextX < 0 || entry->nextX >= game->height 
+            || entry->nextY < 0 || entry->nextY >= game->width) {
+        return false;
+    }
+    return (entry->m > variables->m) && (entry->r >= 0) && (entry->c >= 0);
+}
+
+
+/**
+ * Finds the active computer player's next move, reusing the result from
+ * the position cache when this position has been analysed before.
+ *   - game, a struct of the game state
+ *   - players, an array of players' properties
+ *   - active, the active player: 0 if it is player O or 1 if it is 
+ *   player X
+ *   - x, the row of the of chosen move
+ *   - y, the column of the chosen move
+ */
+void get_computer_move(struct GameProperties* game, struct Player** players,
+        int active, int* x, int* y) {
+    struct MoveAlgorithm* variables = players[active]->variables;
+    struct CacheEntry entry;
+    uint64_t key = 0;
+
+    if (game->cache != NULL) {
+        key = position_key(game, players, active);
+        if (cache_probe(game->cache, key, &entry) == true 
+                && cache_entry_usable(game, variables, &entry) == true) {
+            *x = entry.x;
+            *y = entry.y;
+            variables->m = entry.m;
+            variables->r = entry.r;
+            variables->c = entry.c;
+            variables->nextX = entry.nextX;
+            variables->nextY = entry.nextY;
+            return;
+        }
+    }
+
+    int probes = 0;
+    while (game->gameGrid[variables->nextX][variables->nextY] != '.') {
+        increment_next_move(game, players, active);    
+        probes++;
+    }
+    *x = variables->nextX;
+    *y = variables->nextY;
+    increment_next_move(game, players, active);    
+
+    if (game->cache != NULL) {
+        entry.x = *x;
+        entry.y = *y;
+        entry.m = variables->m;
+        entry.r = variables->r;
+        entry.c = variables->c;
+        entry.nextX = variables->nextX;
+        entry.nextY = variables->nextY;
+        entry.probes = probes;
+        cache_store(game->cache, key, &entry);
+    }
+}
+
+
 /**
  *  Runs the game until a player has lost.
  *   - game, a struct of the game state
@@ -448,19 +1148,16 @@ void run_game(struct GameProperties* game, struct Player** players) {
 
         /* Calculating the x (row) and y (col) of the valid move to make */
         if (players[active]->type == COMPUTER) {
-            while (game->gameGrid[players[active]->variables->nextX]
-                    [players[active]->variables->nextY] != '.') {
-                increment_next_move(game, players, active);    
-            }
-            x = players[active]->variables->nextX;
-            y = players[active]->variables->nextY;
-            increment_next_move(game, players, active);    
+            get_computer_move(game, players, active, &x, &y);
             printf("Player %c: %d %d\n", players[active]->token, x, y);
         } else {
             get_player_move(game, players, active, &x, &y);
         }
         players[active]->move++; 
         game->gameGrid[x][y] = players[active]->token;
+        game->positionHash ^= point_hash(game, x, y, players[active]->token);
+        autosave_move(game, players, 
+                (players[1]->move < players[0]->move) ? 1 : 0);
     }
 }
 
@@ -691,6 +1388,8 @@ void initialise_grid(struct GameProperties* game, char** argv) {
 
 int main(int argc, char** argv) {
     struct GameProperties* game = malloc(sizeof(struct GameProperties));
+    game->cache = NULL;
+    game->autosave = NULL;
 	
     struct Player** players = malloc(sizeof(struct Player*) * 2);    
     for (int i = 0; i < 2; ++i) { 
@@ -707,6 +1406,12 @@ int main(int argc, char** argv) {
         load_saved_data(loadFile, game, players, argv);
         fclose(loadFile);
     }
+    initialise_position_hash(game);
+    select_board_engine(game);
+    if (getenv(CACHE_PATH_VARIABLE) != NULL) {
+        game->cache = open_position_cache(getenv(CACHE_PATH_VARIABLE));
+    }
+    game->autosave = start_autosave();
 
     run_game(game, players);
     return 0;